@@ -19,13 +19,30 @@
 
 #include <gst/gst.h>
 #include <gst/audio/gstaudiosrc.h>
+#include <gst/audio/gstaudioclock.h>
 #include "gstbluetoothaudiosrc.h"
 
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include <WPEFramework/bluetoothaudiosource/bluetoothaudiosource.h>
 
 
 #define RECEIVE_BUFFER_SIZE (64 * 1024)
 
+#define CLOCK_DLL_BANDWIDTH (0.1) /* Hz */
+#define CLOCK_DLL_MAX_ERROR (200 * GST_MSECOND) /* re-anchor beyond this */
+#define CLOCK_DLL_MAX_DEVIATION (0.01) /* of the nominal sample period */
+
+#define DEFAULT_SILENCE_THRESHOLD (0)
+#define DEFAULT_SILENCE_HOLD_TIME (0) /* ms, disabled */
+#define DEFAULT_SILENCE_SUSPEND (FALSE)
+
 GST_DEBUG_CATEGORY_STATIC (gst_bluetoothaudiosrc_debug_category);
 #define GST_CAT_DEFAULT gst_bluetoothaudiosrc_debug_category
 
@@ -46,6 +63,301 @@ static void _audio_source_install_dispose_handler (void)
   }
 }
 
+static gdouble _audio_source_clock_now (void)
+{
+  return ((gdouble) g_get_monotonic_time () * 1000.0);
+}
+
+/* Starts an update of the published state; lock must be held. */
+static void _audio_source_publish_begin (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_atomic_int_inc (&bluetoothaudiosrc->published_sequence);
+}
+
+/* Ends an update of the published state; lock must be held. */
+static void _audio_source_publish_end (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_atomic_int_inc (&bluetoothaudiosrc->published_sequence);
+}
+
+/* Takes a consistent copy of the published state, without taking the lock. */
+static void _audio_source_published_snapshot (GstBluetoothAudioSrc *bluetoothaudiosrc, GstBluetoothAudioSrcPublished *snapshot)
+{
+  gint sequence;
+
+  do {
+    sequence = g_atomic_int_get (&bluetoothaudiosrc->published_sequence);
+    *snapshot = bluetoothaudiosrc->published;
+  } while ((sequence & 1) || (!g_atomic_int_compare_and_exchange (&bluetoothaudiosrc->published_sequence, sequence, sequence)));
+}
+
+/* lock must be held */
+static void _audio_source_clock_publish (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  _audio_source_publish_begin (bluetoothaudiosrc);
+
+  bluetoothaudiosrc->published.frame_rate = bluetoothaudiosrc->frame_rate;
+  bluetoothaudiosrc->published.clock_time = bluetoothaudiosrc->dll_time;
+  bluetoothaudiosrc->published.clock_position = bluetoothaudiosrc->dll_position;
+  bluetoothaudiosrc->published.clock_period = bluetoothaudiosrc->dll_period;
+
+  _audio_source_publish_end (bluetoothaudiosrc);
+}
+
+/* lock must be held */
+static void _audio_source_clock_reset (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  bluetoothaudiosrc->clock = 0;
+
+  bluetoothaudiosrc->dll_locked = FALSE;
+  bluetoothaudiosrc->dll_time = _audio_source_clock_now ();
+  bluetoothaudiosrc->dll_position = 0;
+  bluetoothaudiosrc->dll_period = (bluetoothaudiosrc->frame_rate != 0 ? ((gdouble) GST_SECOND / bluetoothaudiosrc->frame_rate) : 0);
+
+  _audio_source_clock_publish (bluetoothaudiosrc);
+}
+
+/* lock must be held */
+static gdouble _audio_source_clock_position (GstBluetoothAudioSrc *bluetoothaudiosrc, const gdouble now)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+  g_assert (bluetoothaudiosrc->dll_period != 0);
+
+  return (bluetoothaudiosrc->dll_position + ((now - bluetoothaudiosrc->dll_time) / bluetoothaudiosrc->dll_period));
+}
+
+/* Current media clock time; does not take the lock. */
+static GstClockTime _audio_source_clock_time (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  GstClockTime result = GST_CLOCK_TIME_NONE;
+  GstBluetoothAudioSrcPublished snapshot;
+
+  _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+
+  if (snapshot.clock_period != 0) {
+    const gdouble position = (snapshot.clock_position + ((_audio_source_clock_now () - snapshot.clock_time) / snapshot.clock_period));
+    result = (position > 0 ? (GstClockTime) ((position * GST_SECOND) / snapshot.frame_rate) : 0);
+  }
+
+  return (result);
+}
+
+/* Feeds the arrival of a frame into the delay-locked loop; lock must be held. */
+static void _audio_source_clock_update (GstBluetoothAudioSrc *bluetoothaudiosrc, const guint32 samples)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  if ((bluetoothaudiosrc->dll_period == 0) || (samples == 0)) {
+    return;
+  }
+
+  const gdouble now = _audio_source_clock_now ();
+  const gdouble predicted = (bluetoothaudiosrc->dll_time + (samples * bluetoothaudiosrc->dll_period));
+  const gdouble error = (now - predicted);
+
+  if ((!bluetoothaudiosrc->dll_locked) || (fabs (error) > CLOCK_DLL_MAX_ERROR)) {
+    // (Re)start tracking from this frame, continuing from wherever the clock is now.
+    if (bluetoothaudiosrc->dll_locked) {
+      GST_DEBUG_OBJECT (bluetoothaudiosrc, "media clock lost lock (error %" G_GINT64_FORMAT " ns)", (gint64) error);
+    }
+
+    bluetoothaudiosrc->dll_position = _audio_source_clock_position (bluetoothaudiosrc, now);
+    bluetoothaudiosrc->dll_time = now;
+    bluetoothaudiosrc->dll_locked = TRUE;
+  } else {
+    const gdouble nominal = ((gdouble) GST_SECOND / bluetoothaudiosrc->frame_rate);
+    const gdouble omega = ((2 * G_PI * CLOCK_DLL_BANDWIDTH * (predicted - bluetoothaudiosrc->dll_time)) / GST_SECOND);
+
+    bluetoothaudiosrc->dll_time = (predicted + (G_SQRT2 * omega * error));
+    bluetoothaudiosrc->dll_position += samples;
+    bluetoothaudiosrc->dll_period = CLAMP (bluetoothaudiosrc->dll_period + ((omega * omega * error) / samples),
+                                           nominal * (1 - CLOCK_DLL_MAX_DEVIATION), nominal * (1 + CLOCK_DLL_MAX_DEVIATION));
+  }
+
+  _audio_source_clock_publish (bluetoothaudiosrc);
+}
+
+static GstClockTime _audio_source_clock_get_time (GstClock *clock, gpointer user_data)
+{
+  GstBluetoothAudioSrc *bluetoothaudiosrc = GST_BLUETOOTHAUDIOSRC (user_data);
+
+  g_assert (bluetoothaudiosrc != NULL);
+
+  return (_audio_source_clock_time (bluetoothaudiosrc));
+}
+
+/* Copies S16LE samples (or only scans them if destination is NULL), returning TRUE if any of them is louder than the threshold. */
+static inline gboolean _audio_source_copy_samples (guint8 *destination, const guint8 *source, const guint32 length, const gint16 threshold)
+{
+  guint32 i = 0;
+  gboolean loud = FALSE;
+
+#if defined(__SSE2__)
+  const __m128i upper = _mm_set1_epi16 (threshold);
+  const __m128i lower = _mm_set1_epi16 (-threshold);
+  __m128i mask = _mm_setzero_si128 ();
+
+  for (; (i + 16) <= length; i += 16) {
+    const __m128i samples = _mm_loadu_si128 ((const __m128i *) (source + i));
+    if (destination != NULL) {
+      _mm_storeu_si128 ((__m128i *) (destination + i), samples);
+    }
+    mask = _mm_or_si128 (mask, _mm_or_si128 (_mm_cmpgt_epi16 (samples, upper), _mm_cmplt_epi16 (samples, lower)));
+  }
+
+  loud = (_mm_movemask_epi8 (mask) != 0);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const int16x8_t upper = vdupq_n_s16 (threshold);
+  const int16x8_t lower = vdupq_n_s16 (-threshold);
+  uint16x8_t mask = vdupq_n_u16 (0);
+
+  for (; (i + 16) <= length; i += 16) {
+    const uint8x16_t bytes = vld1q_u8 (source + i);
+    const int16x8_t samples = vreinterpretq_s16_u8 (bytes);
+    if (destination != NULL) {
+      vst1q_u8 ((destination + i), bytes);
+    }
+    mask = vorrq_u16 (mask, vorrq_u16 (vcgtq_s16 (samples, upper), vcltq_s16 (samples, lower)));
+  }
+
+#if defined(__aarch64__)
+  loud = (vmaxvq_u16 (mask) != 0);
+#else
+  loud = (vget_lane_u64 (vreinterpret_u64_u16 (vorr_u16 (vget_low_u16 (mask), vget_high_u16 (mask))), 0) != 0);
+#endif
+#endif
+
+  for (; (i + 2) <= length; i += 2) {
+    const gint16 sample = (gint16) GST_READ_UINT16_LE (source + i);
+    if (destination != NULL) {
+      destination[i] = source[i];
+      destination[i + 1] = source[i + 1];
+    }
+    loud |= ((sample > threshold) || (sample < -threshold));
+  }
+
+  if ((destination != NULL) && (i < length)) {
+    destination[i] = source[i];
+  }
+
+  return (loud);
+}
+
+static GstEvent* _audio_source_suspend_event (const gboolean suspend)
+{
+  return (gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM_OOB,
+            gst_structure_new ("GstBluetoothAudioSrcSuspend", "suspend", G_TYPE_BOOLEAN, suspend, NULL)));
+}
+
+/* Returns the resume event to push (outside the lock) if downstream was suspended; lock must be held. */
+static GstEvent* _audio_source_leave_idle (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  GstEvent *event = NULL;
+
+  bluetoothaudiosrc->silence_bytes = 0;
+
+  if (bluetoothaudiosrc->idle) {
+    GST_INFO_OBJECT (bluetoothaudiosrc, "leaving idle mode");
+
+    bluetoothaudiosrc->idle = FALSE;
+    g_cond_signal (&bluetoothaudiosrc->cond);
+
+    if (bluetoothaudiosrc->suspended) {
+      bluetoothaudiosrc->suspended = FALSE;
+      event = _audio_source_suspend_event (FALSE);
+    }
+  }
+
+  return (event);
+}
+
+static void _audio_source_push_event (GstBluetoothAudioSrc *bluetoothaudiosrc, GstEvent *event)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  if (event != NULL) {
+    gst_pad_push_event (GST_BASE_SRC_PAD (bluetoothaudiosrc), event);
+  }
+}
+
+/* Publishes the buffer state for lock-free queries; lock must be held. */
+static void _audio_source_publish_state (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  guint fill_samples = 0;
+  guint fill_ms = 0;
+
+  if (bluetoothaudiosrc->channels != 0) {
+    fill_samples = (bluetoothaudiosrc->buffer_write_offset / (bluetoothaudiosrc->channels * (bluetoothaudiosrc->bps / 8)));
+    fill_ms = (((guint64) fill_samples * 1000) / bluetoothaudiosrc->frame_rate);
+  }
+
+  _audio_source_publish_begin (bluetoothaudiosrc);
+
+  bluetoothaudiosrc->published.fill_samples = fill_samples;
+  bluetoothaudiosrc->published.fill_ms = fill_ms;
+  bluetoothaudiosrc->published.speed = bluetoothaudiosrc->speed;
+  bluetoothaudiosrc->published.buffering = bluetoothaudiosrc->buffering;
+  bluetoothaudiosrc->published.received_samples = bluetoothaudiosrc->received_samples;
+  bluetoothaudiosrc->published.dropped_samples = bluetoothaudiosrc->dropped_samples;
+  bluetoothaudiosrc->published.played_samples = bluetoothaudiosrc->played_samples;
+
+  _audio_source_publish_end (bluetoothaudiosrc);
+}
+
+static GstMessage* _audio_source_buffering_message (GstBluetoothAudioSrc *bluetoothaudiosrc, const gint percent, const gint64 left_ms)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  const gint byte_rate = (bluetoothaudiosrc->bitrate / 8);
+
+  GstMessage *message = gst_message_new_buffering (GST_OBJECT (bluetoothaudiosrc), percent);
+  gst_message_set_buffering_stats (message, GST_BUFFERING_LIVE, byte_rate, byte_rate, left_ms);
+
+  return (message);
+}
+
+/* lock must be held */
+static void _audio_source_start_buffering (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  bluetoothaudiosrc->buffering = TRUE;
+  bluetoothaudiosrc->buffering_percent = -1;
+}
+
+/* Ends (or abandons) prebuffering, returning the final BUFFERING message to post outside the lock; lock must be held. */
+static GstMessage* _audio_source_stop_buffering (GstBluetoothAudioSrc *bluetoothaudiosrc)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  GstMessage *message = NULL;
+
+  if (bluetoothaudiosrc->buffering) {
+    bluetoothaudiosrc->buffering = FALSE;
+    bluetoothaudiosrc->buffering_percent = -1;
+    message = _audio_source_buffering_message (bluetoothaudiosrc, 100, 0);
+  }
+
+  return (message);
+}
+
+static void _audio_source_post_message (GstBluetoothAudioSrc *bluetoothaudiosrc, GstMessage *message)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  if (message != NULL) {
+    gst_element_post_message (GST_ELEMENT (bluetoothaudiosrc), message);
+  }
+}
+
 static uint32_t _audio_source_configure_sink (const bluetoothaudiosource_format_t *format, void *user_data)
 {
   uint32_t result = BLUETOOTHAUDIOSOURCE_SUCCESS;
@@ -89,17 +401,30 @@ static uint32_t _audio_source_set_sink_speed (const int8_t speed, void *user_dat
 
   g_mutex_lock (&bluetoothaudiosrc->lock);
 
+  GstEvent *event = NULL;
+  GstMessage *message = NULL;
+
   if (speed == 0) {
+    // Stay idle (and downstream suspended) if the sender stops during silence.
     bluetoothaudiosrc->playing = FALSE;
+    bluetoothaudiosrc->dll_locked = FALSE;
+    message = _audio_source_stop_buffering (bluetoothaudiosrc);
   }
   else if (speed == 100) {
     bluetoothaudiosrc->reset = FALSE;
     bluetoothaudiosrc->playing = TRUE;
-    bluetoothaudiosrc->buffering = TRUE;
+    event = _audio_source_leave_idle (bluetoothaudiosrc);
+    _audio_source_start_buffering (bluetoothaudiosrc);
   }
 
+  bluetoothaudiosrc->speed = speed;
+  _audio_source_publish_state (bluetoothaudiosrc);
+
   g_mutex_unlock (&bluetoothaudiosrc->lock);
 
+  _audio_source_push_event (bluetoothaudiosrc, event);
+  _audio_source_post_message (bluetoothaudiosrc, message);
+
   return (result);
 }
 
@@ -132,23 +457,87 @@ static void _audio_source_frame (const uint16_t length_bytes, const uint8_t fram
   g_assert (bluetoothaudiosrc != NULL);
 
   gboolean empty = TRUE;
+  GstEvent *event = NULL;
 
   g_mutex_lock (&bluetoothaudiosrc->lock);
 
-  if (length_bytes < (bluetoothaudiosrc->buffer_size - bluetoothaudiosrc->buffer_write_offset)) {
-    memcpy (bluetoothaudiosrc->buffer + bluetoothaudiosrc->buffer_write_offset, frame, length_bytes);
+  const gboolean detect = ((bluetoothaudiosrc->silence_hold_time != 0) && (bluetoothaudiosrc->bitrate != 0));
+  const gint16 threshold = bluetoothaudiosrc->silence_threshold;
+  const gboolean scan = ((detect) && (!bluetoothaudiosrc->idle));
+  gboolean loud = TRUE;
+  guint32 dropped_bytes = 0;
+
+  if ((detect) && (bluetoothaudiosrc->idle)) {
+    // Already idle, so only a frame that ends the silence needs to be kept.
+    loud = _audio_source_copy_samples (NULL, frame, length_bytes, threshold);
+  }
+
+  if (!loud) {
+    // Silence while idle, nothing to copy.
+    dropped_bytes = length_bytes;
+  } else if (length_bytes < (bluetoothaudiosrc->buffer_size - bluetoothaudiosrc->buffer_write_offset)) {
+    if (scan) {
+      loud = _audio_source_copy_samples (bluetoothaudiosrc->buffer + bluetoothaudiosrc->buffer_write_offset, frame, length_bytes, threshold);
+    } else {
+      memcpy (bluetoothaudiosrc->buffer + bluetoothaudiosrc->buffer_write_offset, frame, length_bytes);
+    }
     bluetoothaudiosrc->buffer_write_offset += length_bytes;
   } else {
     // Wrap around...
     const guint16 head = (bluetoothaudiosrc->buffer_size - bluetoothaudiosrc->buffer_write_offset);
     memcpy ((bluetoothaudiosrc->buffer + bluetoothaudiosrc->buffer_write_offset), frame, head);
     memcpy (bluetoothaudiosrc->buffer, (frame + head), (length_bytes - head));
+
+    if (scan) {
+      // The split may fall inside a sample, so scan the frame as a whole.
+      loud = _audio_source_copy_samples (NULL, frame, length_bytes, threshold);
+    }
+    // Everything buffered so far and the head of this frame are lost.
+    dropped_bytes = (bluetoothaudiosrc->buffer_write_offset + head);
     bluetoothaudiosrc->buffer_write_offset = (length_bytes - head);
 
     GST_WARNING_OBJECT (bluetoothaudiosrc, "Buffer overflow");
   }
 
+  if (detect) {
+    if (loud) {
+      if (bluetoothaudiosrc->idle) {
+        // Build up some headroom again before playing out.
+        _audio_source_start_buffering (bluetoothaudiosrc);
+      }
+
+      event = _audio_source_leave_idle (bluetoothaudiosrc);
+    } else if (!bluetoothaudiosrc->idle) {
+      bluetoothaudiosrc->silence_bytes += length_bytes;
+
+      if (bluetoothaudiosrc->silence_bytes >= (((guint64) bluetoothaudiosrc->silence_hold_time * (bluetoothaudiosrc->bitrate / 8)) / 1000)) {
+        GST_INFO_OBJECT (bluetoothaudiosrc, "silence for %u ms, entering idle mode", bluetoothaudiosrc->silence_hold_time);
+
+        bluetoothaudiosrc->idle = TRUE;
+
+        if (bluetoothaudiosrc->silence_suspend) {
+          bluetoothaudiosrc->suspended = TRUE;
+          event = _audio_source_suspend_event (TRUE);
+        }
+      }
+    }
+  }
+
+  if (bluetoothaudiosrc->channels != 0) {
+    const guint32 samples = (length_bytes / (bluetoothaudiosrc->channels * (bluetoothaudiosrc->bps / 8)));
+
+    bluetoothaudiosrc->received_samples += samples;
+    bluetoothaudiosrc->dropped_samples += (dropped_bytes / (bluetoothaudiosrc->channels * (bluetoothaudiosrc->bps / 8)));
+
+    // Silent frames dropped while idle still arrive at the sender's rate, so keep tracking them.
+    _audio_source_clock_update (bluetoothaudiosrc, samples);
+  }
+
+  _audio_source_publish_state (bluetoothaudiosrc);
+
   g_mutex_unlock (&bluetoothaudiosrc->lock);
+
+  _audio_source_push_event (bluetoothaudiosrc, event);
 }
 
 static void _audio_source_callback_state_changed (const bluetoothaudiosource_state_t state, void *user_data)
@@ -206,6 +595,9 @@ static void _audio_source_callback_operational_state_updated (const uint8_t runn
 static void _audio_source_initialize (GstBluetoothAudioSrc *bluetoothaudiosrc)
 {
   g_mutex_init (&bluetoothaudiosrc->lock);
+  g_cond_init (&bluetoothaudiosrc->cond);
+
+  bluetoothaudiosrc->published_sequence = 0;
 
   g_assert (bluetoothaudiosrc != NULL);
 
@@ -226,8 +618,28 @@ static void _audio_source_initialize (GstBluetoothAudioSrc *bluetoothaudiosrc)
   bluetoothaudiosrc->buffering = FALSE;
   bluetoothaudiosrc->reset = FALSE;
 
-  bluetoothaudiosrc->clock = 0;
+  bluetoothaudiosrc->frame_rate = 0;
+  bluetoothaudiosrc->channels = 0;
+  bluetoothaudiosrc->bps = 0;
+  bluetoothaudiosrc->bitrate = 0;
+
   bluetoothaudiosrc->clock_base = 0;
+  _audio_source_clock_reset (bluetoothaudiosrc);
+
+  bluetoothaudiosrc->silence_threshold = DEFAULT_SILENCE_THRESHOLD;
+  bluetoothaudiosrc->silence_hold_time = DEFAULT_SILENCE_HOLD_TIME;
+  bluetoothaudiosrc->silence_suspend = DEFAULT_SILENCE_SUSPEND;
+  bluetoothaudiosrc->silence_bytes = 0;
+  bluetoothaudiosrc->idle = FALSE;
+  bluetoothaudiosrc->suspended = FALSE;
+
+  bluetoothaudiosrc->buffering_percent = -1;
+
+  bluetoothaudiosrc->speed = 0;
+  bluetoothaudiosrc->received_samples = 0;
+  bluetoothaudiosrc->dropped_samples = 0;
+  bluetoothaudiosrc->played_samples = 0;
+  _audio_source_publish_state (bluetoothaudiosrc);
 
   /* Register for the Bluetooth Audio Source service updates... */
   if (bluetoothaudiosource_register_operational_state_update_callback (&_audio_source_callback_operational_state_updated, bluetoothaudiosrc) != BLUETOOTHAUDIOSOURCE_SUCCESS) {
@@ -256,6 +668,7 @@ static void _audio_source_deinitialize (GstBluetoothAudioSrc *bluetoothaudiosrc)
 
   g_mutex_unlock (&bluetoothaudiosrc->lock);
 
+  g_cond_clear (&bluetoothaudiosrc->cond);
   g_mutex_clear (&bluetoothaudiosrc->lock);
 }
 
@@ -280,7 +693,17 @@ static void gst_bluetoothaudiosrc_reset (GstAudioSrc *src);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_SILENCE_THRESHOLD,
+  PROP_SILENCE_HOLD_TIME,
+  PROP_SILENCE_SUSPEND,
+  PROP_FILL_SAMPLES,
+  PROP_FILL_MS,
+  PROP_SPEED,
+  PROP_BUFFERING,
+  PROP_RECEIVED_SAMPLES,
+  PROP_DROPPED_SAMPLES,
+  PROP_PLAYED_SAMPLES
 };
 
 /* pad templates */
@@ -319,6 +742,59 @@ static void gst_bluetoothaudiosrc_class_init (GstBluetoothAudioSrcClass *klass)
   gobject_class->dispose = gst_bluetoothaudiosrc_dispose;
   gobject_class->finalize = gst_bluetoothaudiosrc_finalize;
 
+  g_object_class_install_property (gobject_class, PROP_SILENCE_THRESHOLD,
+      g_param_spec_int ("silence-threshold", "Silence threshold",
+          "Largest absolute sample value still considered silent",
+          0, G_MAXINT16, DEFAULT_SILENCE_THRESHOLD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SILENCE_HOLD_TIME,
+      g_param_spec_uint ("silence-hold-time", "Silence hold time",
+          "Silence duration in ms after which the element goes idle (0 = never)",
+          0, G_MAXUINT, DEFAULT_SILENCE_HOLD_TIME, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SILENCE_SUSPEND,
+      g_param_spec_boolean ("silence-suspend", "Silence suspend",
+          "Send a GstBluetoothAudioSrcSuspend event downstream when going idle and resuming",
+          DEFAULT_SILENCE_SUSPEND, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FILL_SAMPLES,
+      g_param_spec_uint ("fill-samples", "Fill (samples)",
+          "Number of samples currently buffered",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FILL_MS,
+      g_param_spec_uint ("fill-ms", "Fill (ms)",
+          "Duration of the audio currently buffered, in ms",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPEED,
+      g_param_spec_int ("speed", "Speed",
+          "Playback speed last requested by the sender (0 = stopped, 100 = playing)",
+          G_MININT8, G_MAXINT8, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFERING,
+      g_param_spec_boolean ("buffering", "Buffering",
+          "Whether the element is prebuffering before playing out",
+          FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_RECEIVED_SAMPLES,
+      g_param_spec_uint64 ("received-samples", "Received samples",
+          "Number of samples received from the sender since the element was prepared, "
+          "including dropped ones (received = dropped + played + fill)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DROPPED_SAMPLES,
+      g_param_spec_uint64 ("dropped-samples", "Dropped samples",
+          "Number of received samples discarded since the element was prepared, "
+          "as silence while idle or on buffer overflow",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PLAYED_SAMPLES,
+      g_param_spec_uint64 ("played-samples", "Played samples",
+          "Number of received samples handed to the ring buffer since the element was prepared, "
+          "not counting inserted silence; leads the output position by the ring buffer and pipeline latency",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   audio_src_class->open = GST_DEBUG_FUNCPTR (gst_bluetoothaudiosrc_open);
   audio_src_class->prepare = GST_DEBUG_FUNCPTR (gst_bluetoothaudiosrc_prepare);
   audio_src_class->unprepare = GST_DEBUG_FUNCPTR (gst_bluetoothaudiosrc_unprepare);
@@ -339,6 +815,11 @@ static void gst_bluetoothaudiosrc_init (GstBluetoothAudioSrc *bluetoothaudiosrc)
   GST_DEBUG_OBJECT (bluetoothaudiosrc, "init");
 
   _audio_source_initialize (bluetoothaudiosrc);
+
+  /* Provide a clock that follows the sender's media clock instead of the ring buffer's. */
+  GstAudioBaseSrc *audio_base_src = GST_AUDIO_BASE_SRC (bluetoothaudiosrc);
+  gst_object_unref (audio_base_src->clock);
+  audio_base_src->clock = gst_audio_clock_new ("GstBluetoothAudioSrcClock", _audio_source_clock_get_time, bluetoothaudiosrc, NULL);
 }
 
 static void gst_bluetoothaudiosrc_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
@@ -350,6 +831,27 @@ static void gst_bluetoothaudiosrc_set_property (GObject *object, guint property_
   GST_DEBUG_OBJECT (bluetoothaudiosrc, "set_property");
 
   switch (property_id) {
+    case PROP_SILENCE_THRESHOLD:
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      bluetoothaudiosrc->silence_threshold = g_value_get_int (value);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      break;
+    case PROP_SILENCE_HOLD_TIME: {
+      GstEvent *event = NULL;
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      bluetoothaudiosrc->silence_hold_time = g_value_get_uint (value);
+      if (bluetoothaudiosrc->silence_hold_time == 0) {
+        event = _audio_source_leave_idle (bluetoothaudiosrc);
+      }
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      _audio_source_push_event (bluetoothaudiosrc, event);
+      break;
+    }
+    case PROP_SILENCE_SUSPEND:
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      bluetoothaudiosrc->silence_suspend = g_value_get_boolean (value);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -359,12 +861,56 @@ static void gst_bluetoothaudiosrc_set_property (GObject *object, guint property_
 static void gst_bluetoothaudiosrc_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
 {
   GstBluetoothAudioSrc *bluetoothaudiosrc = GST_BLUETOOTHAUDIOSRC (object);
+  GstBluetoothAudioSrcPublished snapshot;
 
   g_assert (bluetoothaudiosrc != NULL);
 
   GST_DEBUG_OBJECT (bluetoothaudiosrc, "get_property");
 
   switch (property_id) {
+    case PROP_SILENCE_THRESHOLD:
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      g_value_set_int (value, bluetoothaudiosrc->silence_threshold);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      break;
+    case PROP_SILENCE_HOLD_TIME:
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      g_value_set_uint (value, bluetoothaudiosrc->silence_hold_time);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      break;
+    case PROP_SILENCE_SUSPEND:
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      g_value_set_boolean (value, bluetoothaudiosrc->silence_suspend);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      break;
+    case PROP_FILL_SAMPLES:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_uint (value, snapshot.fill_samples);
+      break;
+    case PROP_FILL_MS:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_uint (value, snapshot.fill_ms);
+      break;
+    case PROP_SPEED:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_int (value, snapshot.speed);
+      break;
+    case PROP_BUFFERING:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_boolean (value, snapshot.buffering);
+      break;
+    case PROP_RECEIVED_SAMPLES:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_uint64 (value, snapshot.received_samples);
+      break;
+    case PROP_DROPPED_SAMPLES:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_uint64 (value, snapshot.dropped_samples);
+      break;
+    case PROP_PLAYED_SAMPLES:
+      _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+      g_value_set_uint64 (value, snapshot.played_samples);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -403,10 +949,17 @@ static GstStateChangeReturn gst_bluetoothaudiosrc_change_state (GstElement *elem
   g_assert (bluetoothaudiosrc != NULL);
 
   switch (transition) {
-    case GST_STATE_CHANGE_NULL_TO_READY:
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* The base class only announces its own clock, so announce the media clock here. */
+      gst_element_post_message (element,
+          gst_message_new_clock_provide (GST_OBJECT_CAST (element), GST_AUDIO_BASE_SRC (element)->clock, TRUE));
+      break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_element_post_message (element,
+          gst_message_new_clock_lost (GST_OBJECT_CAST (element), GST_AUDIO_BASE_SRC (element)->clock));
+      break;
+    case GST_STATE_CHANGE_NULL_TO_READY:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
     case GST_STATE_CHANGE_READY_TO_NULL:
     case GST_STATE_CHANGE_NULL_TO_NULL:
     case GST_STATE_CHANGE_READY_TO_READY:
@@ -416,9 +969,10 @@ static GstStateChangeReturn gst_bluetoothaudiosrc_change_state (GstElement *elem
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING: {
       GST_INFO_OBJECT (bluetoothaudiosrc, "state changed to playing!");
 
-      struct timespec time_now;
-      timespec_get (&time_now, TIME_UTC);
-      bluetoothaudiosrc->clock_base = GST_TIMESPEC_TO_TIME (time_now);
+      const GstClockTime clock_now = _audio_source_clock_time (bluetoothaudiosrc);
+      g_mutex_lock (&bluetoothaudiosrc->lock);
+      bluetoothaudiosrc->clock_base = (GST_CLOCK_TIME_IS_VALID (clock_now) ? clock_now : 0);
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
       break;
     }
   }
@@ -453,11 +1007,23 @@ static gboolean gst_bluetoothaudiosrc_prepare (GstAudioSrc *src, GstAudioRingBuf
 
   GST_DEBUG_OBJECT (bluetoothaudiosrc, "prepare");
 
+  g_mutex_lock (&bluetoothaudiosrc->lock);
+
   bluetoothaudiosrc->channels = 2;
   bluetoothaudiosrc->bps = 16;
   bluetoothaudiosrc->frame_rate = 44100;
   bluetoothaudiosrc->bitrate = (bluetoothaudiosrc->channels * (bluetoothaudiosrc->bps / 8) * bluetoothaudiosrc->frame_rate * 8);
 
+  _audio_source_clock_reset (bluetoothaudiosrc);
+
+  bluetoothaudiosrc->received_samples = 0;
+  bluetoothaudiosrc->dropped_samples = 0;
+  bluetoothaudiosrc->played_samples = 0;
+  bluetoothaudiosrc->buffering_percent = -1;
+  _audio_source_publish_state (bluetoothaudiosrc);
+
+  g_mutex_unlock (&bluetoothaudiosrc->lock);
+
   return result;
 }
 
@@ -498,6 +1064,32 @@ static guint64 advance_clock(GstBluetoothAudioSrc *bluetoothaudiosrc, guint leng
   return bluetoothaudiosrc->clock;
 }
 
+/* running time of the first sample of the length bytes just handed out */
+static GstClockTime segment_timestamp (GstBluetoothAudioSrc *bluetoothaudiosrc, guint length)
+{
+  g_assert (bluetoothaudiosrc != NULL);
+
+  GstClockTime result = GST_CLOCK_TIME_NONE;
+  GstClock *clock = gst_element_get_clock (GST_ELEMENT (bluetoothaudiosrc));
+
+  if ((clock != NULL) && (bluetoothaudiosrc->bitrate != 0)) {
+    // When the pipeline runs on the media clock this is _audio_source_clock_time(), in the clock's timeline.
+    const GstClockTime clock_now = gst_clock_get_time (clock);
+    const GstClockTime base_time = gst_element_get_base_time (GST_ELEMENT (bluetoothaudiosrc));
+    const GstClockTime duration = gst_util_uint64_scale_int (length, GST_SECOND, (bluetoothaudiosrc->bitrate / 8));
+
+    if (GST_CLOCK_TIME_IS_VALID (clock_now) && (clock_now >= (base_time + duration))) {
+      result = (clock_now - base_time - duration);
+    }
+  }
+
+  if (clock != NULL) {
+    gst_object_unref (clock);
+  }
+
+  return result;
+}
+
 /* read samples from the device */
 static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint length, GstClockTime *timestamp)
 {
@@ -513,6 +1105,7 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
   /* this is a blocking call! */
 
   guint64 clock_played = 0;
+  GstMessage *message = NULL;
 
   while (result != 0) {
 
@@ -524,6 +1117,22 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
       break;
     }
 
+    if ((bluetoothaudiosrc->idle) && (bluetoothaudiosrc->buffer_write_offset == 0)) {
+      // The sender is only sending silence, sleep until it has something to play.
+      GST_DEBUG_OBJECT (bluetoothaudiosrc, "idle...");
+
+      g_cond_wait (&bluetoothaudiosrc->cond, &bluetoothaudiosrc->lock);
+
+      // The media clock kept running meanwhile, so skip the pacing ahead over the idle period.
+      const GstClockTime clock_now = _audio_source_clock_time (bluetoothaudiosrc);
+      if (GST_CLOCK_TIME_IS_VALID (clock_now) && (clock_now > bluetoothaudiosrc->clock_base)) {
+        bluetoothaudiosrc->clock = MAX (bluetoothaudiosrc->clock, (clock_now - bluetoothaudiosrc->clock_base));
+      }
+
+      g_mutex_unlock (&bluetoothaudiosrc->lock);
+      continue;
+    }
+
     guint32 size = length;
 
     if (bluetoothaudiosrc->buffering) {
@@ -531,10 +1140,12 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
       GST_DEBUG_OBJECT (bluetoothaudiosrc, "buffering... (%lu/%lu)", bluetoothaudiosrc->buffer_write_offset, size);
     }
 
-    if (((bluetoothaudiosrc->playing) && (bluetoothaudiosrc->buffer_write_offset >= size))
-          || ((!bluetoothaudiosrc->playing) && (bluetoothaudiosrc->buffer_write_offset != 0)))  {
+    const gboolean draining = ((!bluetoothaudiosrc->playing) || (bluetoothaudiosrc->idle));
+
+    if (((!draining) && (bluetoothaudiosrc->buffer_write_offset >= size))
+          || ((draining) && (bluetoothaudiosrc->buffer_write_offset != 0)))  {
       // if the device is playing and we have  buffered already
-      // or the device is not playing anymore but there is still data available to play out...
+      // or the device is not playing anymore (or idle) but there is still data available to play out...
 
       const guint32 available = (result < bluetoothaudiosrc->buffer_write_offset ? result : bluetoothaudiosrc->buffer_write_offset);
       g_assert (available);
@@ -547,28 +1158,49 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
       result -= available;
 
       clock_played = advance_clock (bluetoothaudiosrc, available);
-      bluetoothaudiosrc->buffering = FALSE;
+      bluetoothaudiosrc->played_samples += (available / (bluetoothaudiosrc->channels * (bluetoothaudiosrc->bps / 8)));
+
+      if (bluetoothaudiosrc->buffering) {
+        // Prebuffering may have restarted since an earlier pass took its 100% message; that one is stale.
+        if (message != NULL) {
+          gst_message_unref (message);
+        }
+
+        message = _audio_source_stop_buffering (bluetoothaudiosrc);
+      }
     }
     else {
       if (bluetoothaudiosrc->playing && !bluetoothaudiosrc->buffering)
         GST_WARNING_OBJECT (bluetoothaudiosrc, "buffer underflow (%lu/%lu)", bluetoothaudiosrc->buffer_write_offset, size);
 
+      if (bluetoothaudiosrc->playing && bluetoothaudiosrc->buffering) {
+        const gint percent = ((bluetoothaudiosrc->buffer_write_offset * 100) / size);
+
+        if ((percent != bluetoothaudiosrc->buffering_percent) && (message == NULL)) {
+          bluetoothaudiosrc->buffering_percent = percent;
+          message = _audio_source_buffering_message (bluetoothaudiosrc, percent,
+                      (((gint64) (size - bluetoothaudiosrc->buffer_write_offset) * 1000) / (bluetoothaudiosrc->bitrate / 8)));
+        }
+      }
+
       // Not playing currently, but since this is live playback, stuff it.
       memset (data + (length - result), 0, result);
       clock_played = advance_clock (bluetoothaudiosrc, result);
       result = 0;
     }
 
+    _audio_source_publish_state (bluetoothaudiosrc);
+
     g_mutex_unlock (&bluetoothaudiosrc->lock);
   }
 
+  _audio_source_post_message (bluetoothaudiosrc, message);
+
   if (clock_played) {
-    // GstAudioSrc is a live source, so ensure the data is served at a roughly real time pace.
+    // GstAudioSrc is a live source, so ensure the data is served at the sender's pace.
 
-    struct timespec time_now;
-    timespec_get (&time_now, TIME_UTC);
+    const GstClockTime clock_now = _audio_source_clock_time (bluetoothaudiosrc);
 
-    const GstClockTime clock_now = GST_TIMESPEC_TO_TIME (time_now);
     const GstClockTime clock_elapsed = (clock_now - bluetoothaudiosrc->clock_base);
     const GstClockTime clock_sleep = (clock_played > clock_elapsed ? (clock_played - clock_elapsed) : 0);
 
@@ -576,6 +1208,9 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
       g_usleep (clock_sleep / 1000);
   }
 
+  // Timestamp the segment on the clock's timeline rather than by ring buffer sample count.
+  *timestamp = segment_timestamp (bluetoothaudiosrc, length);
+
   return length;
 }
 
@@ -583,13 +1218,16 @@ static guint gst_bluetoothaudiosrc_read (GstAudioSrc *src, gpointer data, guint
 static guint gst_bluetoothaudiosrc_delay (GstAudioSrc *src)
 {
   GstBluetoothAudioSrc *bluetoothaudiosrc = GST_BLUETOOTHAUDIOSRC (src);
-  guint delay = 0;
+  GstBluetoothAudioSrcPublished snapshot;
 
   g_assert (bluetoothaudiosrc != NULL);
 
   // GST_DEBUG_OBJECT (bluetoothaudiosrc, "delay");
 
-  return delay;
+  /* samples received but not yet read out */
+  _audio_source_published_snapshot (bluetoothaudiosrc, &snapshot);
+
+  return snapshot.fill_samples;
 }
 
 /* reset the audio device, unblock from a read */
@@ -604,8 +1242,14 @@ static void gst_bluetoothaudiosrc_reset (GstAudioSrc *src)
   g_mutex_lock (&bluetoothaudiosrc->lock);
 
   bluetoothaudiosrc->reset = TRUE;
+  g_cond_signal (&bluetoothaudiosrc->cond);
+
+  GstMessage *message = _audio_source_stop_buffering (bluetoothaudiosrc);
+  _audio_source_publish_state (bluetoothaudiosrc);
 
   g_mutex_unlock (&bluetoothaudiosrc->lock);
+
+  _audio_source_post_message (bluetoothaudiosrc, message);
 }
 
 static gboolean plugin_init (GstPlugin *plugin)
@@ -33,6 +33,24 @@ G_BEGIN_DECLS
 
 typedef struct _GstBluetoothAudioSrc GstBluetoothAudioSrc;
 typedef struct _GstBluetoothAudioSrcClass GstBluetoothAudioSrcClass;
+typedef struct _GstBluetoothAudioSrcPublished GstBluetoothAudioSrcPublished;
+
+// state readable without taking the lock, see published_sequence
+struct _GstBluetoothAudioSrcPublished
+{
+  guint32 frame_rate;
+  gdouble clock_time;
+  gdouble clock_position;
+  gdouble clock_period;
+
+  guint32 fill_samples;
+  guint32 fill_ms;
+  gint speed;
+  gboolean buffering;
+  guint64 received_samples;
+  guint64 dropped_samples;
+  guint64 played_samples;
+};
 
 struct _GstBluetoothAudioSrc
 {
@@ -58,7 +76,33 @@ struct _GstBluetoothAudioSrc
   guint64 clock_base;
   guint64 clock;
 
+  // media clock, recovered from the frame arrival rate
+  gboolean dll_locked;
+  gdouble dll_time;
+  gdouble dll_position;
+  gdouble dll_period;
+
+  // silence detection
+  gint silence_threshold;
+  guint silence_hold_time;
+  gboolean silence_suspend;
+  guint64 silence_bytes;
+  gboolean idle;
+  gboolean suspended;
+
+  gint buffering_percent;
+
+  gint8 speed;
+  guint64 received_samples;
+  guint64 dropped_samples;
+  guint64 played_samples;
+
+  // seqlock: odd while the (lock holding) writer updates published
+  gint published_sequence;
+  GstBluetoothAudioSrcPublished published;
+
   GMutex lock;
+  GCond cond;
 };
 
 struct _GstBluetoothAudioSrcClass